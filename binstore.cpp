@@ -0,0 +1,165 @@
+#include <assert.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "binstore.h"
+
+// Scans the columns have room for before the first growth.
+static const uint32_t InitialScans = 1024;
+
+bool FitGrid(const float * frequency,
+             uint32_t size,
+             int binCount,
+             double & startFrequency,
+             double & stopFrequency)
+{
+  if (size == 0 || binCount < 2) {
+    return false;
+  }
+  auto range = std::minmax_element(frequency, frequency + size);
+  double binSize = (double(*range.second) - *range.first) / (binCount - 1);
+  if (binSize <= 0) {
+    return false;
+  }
+  startFrequency = *range.first;
+  stopFrequency = *range.first + binSize * binCount;
+  return true;
+}
+
+void BinPeakPower(const float * frequency,
+                  const float * power,
+                  uint32_t size,
+                  double startFrequency,
+                  double stopFrequency,
+                  float * destination,
+                  int binCount)
+{
+  double binSize = (stopFrequency - startFrequency) / binCount;
+  std::fill(destination, destination + binCount, std::numeric_limits<float>::quiet_NaN());
+  for (uint32_t i = 0; i < size; i++) {
+    double bin = std::floor((frequency[i] - startFrequency) / binSize + 0.5);
+    if (!(bin >= 0 && bin < binCount)) {
+      continue;
+    }
+    float & value = destination[int(bin)];
+    if (power[i] > value || std::isnan(value)) {
+      value = power[i];
+    }
+  }
+}
+
+BinStore::BinStore(double startFrequency, double stopFrequency, int binCount, uint32_t retainScans)
+  : m_startFrequency(startFrequency),
+    m_stopFrequency(stopFrequency),
+    m_binCount(binCount),
+    m_retainScans(retainScans),
+    m_maximumScans(retainScans + std::max<uint32_t>(retainScans / 4, 1)),
+    m_times(),
+    m_columns(binCount)
+{
+  assert(binCount > 0 && retainScans > 0);
+  uint32_t initialScans = std::min(InitialScans, this->m_maximumScans);
+  this->m_times.reserve(initialScans);
+  for (int i = 0; i < binCount; i++) {
+    this->m_columns[i].reserve(initialScans);
+  }
+}
+
+// The bin whose centre is nearest frequency, or -1 if frequency is not on
+// the grid.
+int BinStore::GetBin(double frequency)
+{
+  double binSize = (this->m_stopFrequency - this->m_startFrequency) / this->m_binCount;
+  double bin = std::floor((frequency - this->m_startFrequency) / binSize + 0.5);
+  if (!(bin >= 0 && bin < this->m_binCount)) {
+    return -1;
+  }
+  return int(bin);
+}
+
+// Drop the oldest scans beyond the retention from every column.
+void BinStore::Trim()
+{
+  uint32_t dropped = this->m_times.size() - this->m_retainScans;
+  this->m_times.erase(this->m_times.begin(), this->m_times.begin() + dropped);
+  for (int i = 0; i < this->m_binCount; i++) {
+    this->m_columns[i].erase(this->m_columns[i].begin(), this->m_columns[i].begin() + dropped);
+  }
+}
+
+// Add one scan, already put on the grid by BinPeakPower, to the end of
+// every column.  Columns grow together, doubling until they reach the
+// maximum, so appends are amortized constant per bin.  Times must not go
+// backwards for the range lookups; an earlier time is clamped to the
+// latest one.
+void BinStore::AppendScan(time_t time, const float * power)
+{
+  if (this->m_times.size() >= this->m_maximumScans) {
+    this->Trim();
+  } else if (this->m_times.size() == this->m_times.capacity()) {
+    size_t capacity = std::min<size_t>(2 * this->m_times.capacity(), this->m_maximumScans);
+    this->m_times.reserve(capacity);
+    for (int i = 0; i < this->m_binCount; i++) {
+      this->m_columns[i].reserve(capacity);
+    }
+  }
+  this->m_times.push_back(std::max(time, this->GetLatestTime()));
+  for (int i = 0; i < this->m_binCount; i++) {
+    this->m_columns[i].push_back(power[i]);
+  }
+}
+
+void BinStore::GetScanRange(time_t startTime, time_t stopTime, uint32_t & first, uint32_t & last)
+{
+  first = std::lower_bound(this->m_times.begin(), this->m_times.end(), startTime) - this->m_times.begin();
+  last = std::upper_bound(this->m_times.begin(), this->m_times.end(), stopTime) - this->m_times.begin();
+  last = std::max(first, last);
+}
+
+// Power in the bin of frequency for each scan in the time range.  Returns
+// false if frequency is not on the grid.
+bool BinStore::GetSeries(double frequency, time_t startTime, time_t stopTime, BinSeries & series)
+{
+  int bin = this->GetBin(frequency);
+  if (bin < 0) {
+    return false;
+  }
+  uint32_t first, last;
+  this->GetScanRange(startTime, stopTime, first, last);
+  series.m_power = this->m_columns[bin].data() + first;
+  series.m_time = this->m_times.data() + first;
+  series.m_size = last - first;
+  return true;
+}
+
+// Peak power across the bins of a band for each scan in the time range,
+// ignoring empty bins.  peak holds the values series points to.  Returns
+// false unless both ends of the band are on the grid.
+bool BinStore::GetBandSeries(double lowFrequency,
+                             double highFrequency,
+                             time_t startTime,
+                             time_t stopTime,
+                             std::vector<float> & peak,
+                             BinSeries & series)
+{
+  int lowBin = this->GetBin(lowFrequency);
+  int highBin = this->GetBin(highFrequency);
+  if (lowBin < 0 || highBin < lowBin) {
+    return false;
+  }
+  uint32_t first, last;
+  this->GetScanRange(startTime, stopTime, first, last);
+  peak.assign(last - first, std::numeric_limits<float>::quiet_NaN());
+  for (int bin = lowBin; bin <= highBin; bin++) {
+    const float * column = this->m_columns[bin].data() + first;
+    for (uint32_t i = 0; i < last - first; i++) {
+      if (column[i] > peak[i] || std::isnan(peak[i])) {
+        peak[i] = column[i];
+      }
+    }
+  }
+  series.m_power = peak.data();
+  series.m_time = this->m_times.data() + first;
+  series.m_size = last - first;
+  return true;
+}
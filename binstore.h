@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <time.h>
+#include <stdint.h>
+
+// The grids here are the GetMagnitudeData grid: binCount bins with bin i
+// centred on startFrequency + i * (stopFrequency - startFrequency) / binCount.
+
+// Fit a grid to a scan so its lowest and highest frequencies are the
+// centres of the first and last bins.  Returns false for a scan without
+// two distinct frequencies.
+bool FitGrid(const float * frequency,
+             uint32_t size,
+             int binCount,
+             double & startFrequency,
+             double & stopFrequency);
+
+// Put one scan on a grid.  Each bin holds the highest power of the inputs
+// nearest to it, or NaN when no input falls in the bin.
+void BinPeakPower(const float * frequency,
+                  const float * power,
+                  uint32_t size,
+                  double startFrequency,
+                  double stopFrequency,
+                  float * destination,
+                  int binCount);
+
+// A run of power over consecutive scans.  Points into the store, so it is
+// only valid until the next AppendScan.
+struct BinSeries
+{
+  const float * m_power;
+  const time_t * m_time;
+  uint32_t m_size;
+};
+
+// Bin-major copy of scans put on a fixed grid by BinPeakPower.  Each bin
+// owns a contiguous column holding its power for every scan kept, so a
+// time series for one frequency reads only that column.
+//
+// The store keeps the latest retainScans scans.  Columns grow to a quarter
+// more than that before they are cut back to retainScans, so the store
+// never holds more than 1.25 * retainScans * binCount floats, and the cost
+// of trimming is spread over the appends in between.
+class BinStore
+{
+  double m_startFrequency;
+  double m_stopFrequency;
+  int m_binCount;
+  uint32_t m_retainScans;
+  uint32_t m_maximumScans;
+  std::vector<time_t> m_times;
+  std::vector<std::vector<float>> m_columns;
+ private:
+  void GetScanRange(time_t startTime, time_t stopTime, uint32_t & first, uint32_t & last);
+  void Trim();
+ public:
+  BinStore(double startFrequency, double stopFrequency, int binCount, uint32_t retainScans);
+  int GetBinCount() {
+    return this->m_binCount;
+  }
+  double GetStartFrequency() {
+    return this->m_startFrequency;
+  }
+  double GetStopFrequency() {
+    return this->m_stopFrequency;
+  }
+  double GetBinFrequency(int bin) {
+    return this->m_startFrequency + bin * (this->m_stopFrequency - this->m_startFrequency) / this->m_binCount;
+  }
+  uint32_t GetScanCount() {
+    return this->m_times.size();
+  }
+  time_t GetLatestTime() {
+    return this->m_times.empty() ? 0 : this->m_times.back();
+  }
+  int GetBin(double frequency);
+  void AppendScan(time_t time, const float * power);
+  bool GetSeries(double frequency, time_t startTime, time_t stopTime, BinSeries & series);
+  bool GetBandSeries(double lowFrequency,
+                     double highFrequency,
+                     time_t startTime,
+                     time_t stopTime,
+                     std::vector<float> & peak,
+                     BinSeries & series);
+};
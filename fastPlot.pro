@@ -16,10 +16,20 @@ QMAKE_CXXFLAGS = -std=c++11
 SOURCES += main.cpp\
            mainwindow.cpp \
            reader.cpp \
+           shmreader.cpp \
+           formatreader.cpp \
+           binstore.cpp \
+           scanpipeline.cpp \
            ../../Qt/qcustomplot/qcustomplot.cpp
 
 HEADERS  += mainwindow.h \
+         reader.h \
+         shmreader.h \
+         formatreader.h \
+         binstore.h \
+         scanpipeline.h \
          ../../Qt/qcustomplot/qcustomplot.h
 
 FORMS    += mainwindow.ui
 
+unix:!macx: LIBS += -lrt
@@ -0,0 +1,47 @@
+#include <string.h>
+#include <stdlib.h>
+#include "formatreader.h"
+
+time_t ParseScanTime(const char * text, const char * format)
+{
+  struct tm timeStruct;
+  memset(&timeStruct, 0, sizeof(struct tm));
+  timeStruct.tm_isdst = -1;
+  if (strptime(text, format, &timeStruct) == NULL) {
+    fprintf(stderr, "Unable to parse scan time %s\n", text);
+    return 0;
+  }
+  return mktime(&timeStruct);
+}
+
+ScanSource * OpenScanReader(const char * fileName)
+{
+  // Lines examined for a known format before falling back.
+  const uint32_t detectLines = 64;
+  FILE * file = fopen(fileName, "r");
+  if (file == NULL) {
+    perror(fileName);
+    return NULL;
+  }
+  // Detect the format from the first lines and hand the matching one to
+  // the reader so that pipes work as well as files.  The lines skipped
+  // carry nothing any format could use.
+  char * line = NULL;
+  size_t capacity = 0;
+  ScanSource * reader = NULL;
+  for (uint32_t i = 0; reader == NULL && i < detectLines && getline(&line, &capacity, file) != -1; i++) {
+    if (NativeFormat::Detect(line)) {
+      reader = new FormatReader<NativeFormat>(file, line);
+    } else if (RtlPowerFormat::Detect(line)) {
+      reader = new FormatReader<RtlPowerFormat>(file, line);
+    } else if (HackRfSweepFormat::Detect(line)) {
+      reader = new FormatReader<HackRfSweepFormat>(file, line);
+    }
+  }
+  free(line);
+  if (reader == NULL) {
+    fprintf(stderr, "No known scan format at the start of %s, reading it as scanner output\n", fileName);
+    reader = new FormatReader<NativeFormat>(file);
+  }
+  return reader;
+}
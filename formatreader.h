@@ -0,0 +1,303 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <cmath>
+#include <algorithm>
+#include "reader.h"
+
+// Scan reader whose line format is a compile-time policy.  A policy is a
+// struct providing
+//
+//   struct State;
+//   static bool Detect(const char * line);
+//   static bool ParseLine(const char * line, State & state, Buffer * buffer);
+//
+// ParseLine appends the bins of one line to buffer and returns false, or
+// returns true without touching buffer when the line starts the next scan.
+// The reader hands that line back first on the following GetNext, when
+// buffer is empty, so a policy never reports a boundary for an empty scan.
+
+time_t ParseScanTime(const char * text, const char * format);
+
+// Parse an unsigned or floating point number, skipping leading blanks.
+// Returns the character after the number, or NULL when there is none.
+static inline const char * ParseNumber(const char * cursor, double & value)
+{
+  static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  while (*cursor == ' ' || *cursor == '\t') {
+    cursor++;
+  }
+  bool negative = false;
+  if (*cursor == '-' || *cursor == '+') {
+    negative = *cursor == '-';
+    cursor++;
+  }
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  for (; *cursor >= '0' && *cursor <= '9'; cursor++, digits++) {
+    if (mantissa < 1000000000000000000ULL) {
+      mantissa = mantissa * 10 + (*cursor - '0');
+    } else {
+      exponent++;
+    }
+  }
+  if (*cursor == '.') {
+    cursor++;
+    for (; *cursor >= '0' && *cursor <= '9'; cursor++, digits++) {
+      if (mantissa < 1000000000000000000ULL) {
+        mantissa = mantissa * 10 + (*cursor - '0');
+        exponent--;
+      }
+    }
+  }
+  if (digits == 0) {
+    return NULL;
+  }
+  if (*cursor == 'e' || *cursor == 'E') {
+    const char * exponentStart = cursor + 1;
+    bool negativeExponent = false;
+    if (*exponentStart == '-' || *exponentStart == '+') {
+      negativeExponent = *exponentStart == '-';
+      exponentStart++;
+    }
+    if (*exponentStart >= '0' && *exponentStart <= '9') {
+      int explicitExponent = 0;
+      for (cursor = exponentStart; *cursor >= '0' && *cursor <= '9'; cursor++) {
+        explicitExponent = explicitExponent * 10 + (*cursor - '0');
+      }
+      exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+  }
+  double result = double(mantissa);
+  if (exponent < 0 && exponent >= -22) {
+    result /= powersOfTen[-exponent];
+  } else if (exponent > 0 && exponent <= 22) {
+    result *= powersOfTen[exponent];
+  } else if (exponent != 0) {
+    result *= pow(10.0, exponent);
+  }
+  value = negative ? -result : result;
+  return cursor;
+}
+
+static inline bool HasPrefix(const char * line, const char * prefix, size_t length)
+{
+  return strncmp(line, prefix, length) == 0;
+}
+
+// The original scanner output:
+//
+//   Start scan at 20160101-12:00:00
+//   freq 88000000 power_db -42.5
+//
+struct NativeFormat
+{
+  struct State {};
+  static bool Detect(const char * line) {
+    return HasPrefix(line, "Start scan at ", 14) || HasPrefix(line, "freq ", 5);
+  }
+  static bool ParseLine(const char * line, State &, Buffer * buffer) {
+    double frequency;
+    double power;
+    const char * cursor;
+    if (HasPrefix(line, "freq ", 5)) {
+      if ((cursor = ParseNumber(line + 5, frequency)) != NULL &&
+          HasPrefix(cursor, " power_db ", 10) &&
+          ParseNumber(cursor + 10, power) != NULL) {
+        buffer->AddData(float(frequency), float(power));
+      }
+    } else if (HasPrefix(line, "Start scan at ", 14)) {
+      if (buffer->size() != 0) {
+        return true;
+      }
+      buffer->SetTime(ParseScanTime(line + 14, "%Y%m%d-%T"));
+    }
+    return false;
+  }
+};
+
+// Fields shared by the rtl_power and hackrf_sweep CSV formats:
+//
+//   date, time, Hz low, Hz high, Hz step, samples, dB, dB, ...
+//
+struct SweepCsvLine
+{
+  const char * m_timeEnd;
+  double m_lowFrequency;
+  double m_highFrequency;
+  double m_binWidth;
+  const char * m_bins;
+
+  static bool IsSweepCsv(const char * line) {
+    // YYYY-MM-DD, HH:MM:SS
+    static const char pattern[] = "dddd-dd-dd, dd:dd:dd";
+    for (uint32_t i = 0; i < sizeof(pattern) - 1; i++) {
+      if (pattern[i] == 'd' ? (line[i] < '0' || line[i] > '9') : line[i] != pattern[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool Parse(const char * line) {
+    const char * cursor = strchr(line, ',');
+    if (cursor == NULL || (cursor = strchr(cursor + 1, ',')) == NULL) {
+      return false;
+    }
+    double samples;
+    this->m_timeEnd = cursor;
+    if ((cursor = ParseNumber(cursor + 1, this->m_lowFrequency)) == NULL || *cursor != ',' ||
+        (cursor = ParseNumber(cursor + 1, this->m_highFrequency)) == NULL || *cursor != ',' ||
+        (cursor = ParseNumber(cursor + 1, this->m_binWidth)) == NULL || *cursor != ',' ||
+        (cursor = ParseNumber(cursor + 1, samples)) == NULL) {
+      return false;
+    }
+    this->m_bins = cursor;
+    return true;
+  }
+  // Append one bin per dB value, centred binOffset widths above its start.
+  // A value that is not a finite number (nan, -inf) leaves its bin out but
+  // keeps the following bins at their frequencies.
+  void AppendBins(Buffer * buffer, double binOffset) const {
+    const char * cursor = this->m_bins;
+    double power;
+    for (uint32_t i = 0; cursor != NULL && *cursor == ','; i++) {
+      const char * end = ParseNumber(cursor + 1, power);
+      if (end != NULL && (*end == ',' || *end == '\n' || *end == '\r' || *end == '\0')) {
+        buffer->AddData(float(this->m_lowFrequency + (i + binOffset) * this->m_binWidth), float(power));
+        cursor = end;
+      } else {
+        cursor = strchr(cursor + 1, ',');
+      }
+    }
+  }
+};
+
+// rtl_power: every line of one sweep carries the same timestamp.
+struct RtlPowerFormat
+{
+  struct State {
+    char m_time[64];
+    size_t m_timeLength;
+  };
+  static bool Detect(const char * line) {
+    return SweepCsvLine::IsSweepCsv(line) && line[20] == ',';
+  }
+  static bool ParseLine(const char * line, State & state, Buffer * buffer) {
+    SweepCsvLine sweep;
+    if (!sweep.Parse(line)) {
+      return false;
+    }
+    size_t timeLength = sweep.m_timeEnd - line;
+    if (buffer->size() == 0) {
+      state.m_timeLength = std::min(timeLength, sizeof(state.m_time) - 1);
+      memcpy(state.m_time, line, state.m_timeLength);
+      state.m_time[state.m_timeLength] = '\0';
+      buffer->SetTime(ParseScanTime(state.m_time, "%Y-%m-%d, %H:%M:%S"));
+    } else if (timeLength != state.m_timeLength || memcmp(line, state.m_time, timeLength) != 0) {
+      return true;
+    }
+    sweep.AppendBins(buffer, 0.0);
+    return false;
+  }
+};
+
+// hackrf_sweep: timestamps change within a sweep and the interleaved
+// output is not in frequency order, so a new sweep starts where a line is
+// back at or below the frequency the current sweep started at.
+struct HackRfSweepFormat
+{
+  struct State {
+    double m_sweepStart;
+  };
+  static bool Detect(const char * line) {
+    return SweepCsvLine::IsSweepCsv(line) && line[20] == '.';
+  }
+  static bool ParseLine(const char * line, State & state, Buffer * buffer) {
+    SweepCsvLine sweep;
+    if (!sweep.Parse(line)) {
+      return false;
+    }
+    if (buffer->size() == 0) {
+      buffer->SetTime(ParseScanTime(line, "%Y-%m-%d, %H:%M:%S"));
+      state.m_sweepStart = sweep.m_lowFrequency;
+    } else if (sweep.m_lowFrequency <= state.m_sweepStart) {
+      return true;
+    }
+    sweep.AppendBins(buffer, 0.5);
+    return false;
+  }
+};
+
+template <typename Format>
+class FormatReader : public ScanSource
+{
+  FILE * m_inputFile;
+  char * m_line;
+  size_t m_lineCapacity;
+  bool m_pending;
+  Buffer * m_buffer;
+  typename Format::State m_state;
+  bool m_done;
+ public:
+  // firstLine is a line already consumed from file, e.g. for detection.
+  FormatReader(FILE * file, const char * firstLine = NULL)
+    : m_inputFile(file),
+      m_line(NULL),
+      m_lineCapacity(0),
+      m_pending(false),
+      m_buffer(new Buffer(1024)),
+      m_state(),
+      m_done(false)
+  {
+    if (firstLine != NULL) {
+      this->m_lineCapacity = strlen(firstLine) + 1;
+      this->m_line = static_cast<char *>(malloc(this->m_lineCapacity));
+      memcpy(this->m_line, firstLine, this->m_lineCapacity);
+      this->m_pending = true;
+    }
+  }
+  ~FormatReader() {
+    delete this->m_buffer;
+    free(this->m_line);
+    fclose(this->m_inputFile);
+  }
+  FormatReader(const FormatReader &) = delete;
+  FormatReader & operator=(const FormatReader &) = delete;
+  int GetNext(Buffer * & buffer) override {
+    if (this->IsDone()) {
+      return -1;
+    }
+    this->m_buffer->m_size = 0;
+    this->m_buffer->m_time = 0;
+    for (;;) {
+      if (!this->m_pending && getline(&this->m_line, &this->m_lineCapacity, this->m_inputFile) == -1) {
+        this->m_done = true;
+        break;
+      }
+      this->m_pending = Format::ParseLine(this->m_line, this->m_state, this->m_buffer);
+      if (this->m_pending) {
+        break;
+      }
+    }
+    buffer = this->m_buffer;
+    return this->m_done && this->m_buffer->size() == 0 ? -1 : 0;
+  }
+  bool IsDone() override {
+    return this->m_done;
+  }
+};
+
+// Open fileName and pick the reader matching the first line any format
+// recognizes, looking a little way past headers or blank lines.  Falls back
+// to the native format, which ignores unknown lines as DataReader did.
+// Returns NULL if the file cannot be opened.
+ScanSource * OpenScanReader(const char * fileName);
@@ -26,7 +26,11 @@
 #include <QApplication>
 #include <QCommandLineParser>
 #include <string>
+#include <algorithm>
+#include <stdio.h>
 #include "mainwindow.h"
+#include "shmreader.h"
+#include "formatreader.h"
 
 int main(int argc, char *argv[])
 {
@@ -41,13 +45,32 @@ int main(int argc, char *argv[])
   parser.setApplicationDescription("Program to plot output of scanner");
   parser.addHelpOption();
   parser.addVersionOption();
-  parser.addPositionalArgument("<input>", QCoreApplication::translate("main", "Input file."));
+  parser.addPositionalArgument("<input>", QCoreApplication::translate("main", "Input file: scanner output, rtl_power or hackrf_sweep CSV."));
 
   // An option with a value
   QCommandLineOption delayOption(QStringList() << "d" << "delay",
                                  QCoreApplication::translate("main", "Set the delay to plot each scan."),
                                  QCoreApplication::translate("main", "delay in ms"));
   parser.addOption(delayOption);
+  QCommandLineOption shmOption(QStringList() << "s" << "shm",
+                               QCoreApplication::translate("main", "Read scans from a shared-memory ring instead of an input file."),
+                               QCoreApplication::translate("main", "shm name"));
+  parser.addOption(shmOption);
+  QCommandLineOption waterfallOption(QStringList() << "w" << "waterfall",
+                                     QCoreApplication::translate("main", "Show a waterfall of recent scans."));
+  parser.addOption(waterfallOption);
+  QCommandLineOption trackOption(QStringList() << "t" << "track",
+                                 QCoreApplication::translate("main", "Show power over time at a frequency."),
+                                 QCoreApplication::translate("main", "frequency in MHz"));
+  parser.addOption(trackOption);
+  QCommandLineOption trackBandOption(QStringList() << "track-band",
+                                     QCoreApplication::translate("main", "Show peak power over time in a band."),
+                                     QCoreApplication::translate("main", "low:high in MHz"));
+  parser.addOption(trackBandOption);
+  QCommandLineOption trackScansOption(QStringList() << "track-scans",
+                                      QCoreApplication::translate("main", "Keep this many scans for the time series, 1024 floats each (default 32768)."),
+                                      QCoreApplication::translate("main", "scans"));
+  parser.addOption(trackScansOption);
 
   // Process the actual command line arguments given by the user
   parser.process(a);
@@ -55,17 +78,52 @@ int main(int argc, char *argv[])
   const QStringList args = parser.positionalArguments();
 
   // source is args.at(0), destination is args.at(1)
-  if (args.size() == 0) {
+  if (args.size() == 0 && !parser.isSet(shmOption)) {
     parser.showHelp();
   }
 
-  QString inputFile = args.at(0);
   uint32_t delay = 0;
   if (parser.value(delayOption) != QString("")) {
     delay = parser.value(delayOption).toUInt();
   }
+  double trackLowFrequency = 0;
+  double trackHighFrequency = 0;
+  if (parser.value(trackOption) != QString("")) {
+    trackLowFrequency = trackHighFrequency = parser.value(trackOption).toDouble() * 1e6;
+  }
+  if (parser.value(trackBandOption) != QString("")) {
+    QStringList band = parser.value(trackBandOption).split(':');
+    bool lowOk = false;
+    bool highOk = false;
+    if (band.size() == 2) {
+      trackLowFrequency = band.at(0).toDouble(&lowOk) * 1e6;
+      trackHighFrequency = band.at(1).toDouble(&highOk) * 1e6;
+    }
+    if (!lowOk || !highOk || trackLowFrequency <= 0 || trackHighFrequency < trackLowFrequency) {
+      fprintf(stderr, "Bad band %s, expected low:high in MHz\n", parser.value(trackBandOption).toLatin1().data());
+      return 1;
+    }
+  }
+  uint32_t trackScans = 32768;
+  if (parser.value(trackScansOption) != QString("")) {
+    trackScans = std::max(parser.value(trackScansOption).toUInt(), 1u);
+  }
+
+  // Either source hands out scans through the same ScanSource interface.
+  QByteArray sourceName;
+  ScanSource * source;
+  if (parser.isSet(shmOption)) {
+    sourceName = parser.value(shmOption).toLatin1();
+    source = new ShmRingReader(sourceName.data());
+  } else {
+    sourceName = args.at(0).toLatin1();
+    source = OpenScanReader(sourceName.data());
+    if (source == NULL) {
+      return 1;
+    }
+  }
 
-  MainWindow w(inputFile.toLatin1().data(), delay);
+  MainWindow w(source, delay, parser.isSet(waterfallOption), trackLowFrequency, trackHighFrequency, trackScans);
   w.show();
   
   return a.exec();
@@ -46,18 +46,55 @@
 #include <QScreen>
 #include <QMessageBox>
 #include <QMetaEnum>
+#include <QElapsedTimer>
 #include <limits>
+#include <cmath>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
-MainWindow::MainWindow(const char * inputFile, uint32_t delayMilliSeconds, QWidget * parent) :
+// With no delay, scans that are ready are decoded for up to this long per
+// tick, so decoding keeps up with a live source whatever the panes cost.
+static const qint64 DecodeBudgetMilliSeconds = 10;
+// Poll interval for a live source that has nothing new.
+static const uint32_t IdleMilliSeconds = 20;
+// Scans kept by the pipeline; the spectrum overlays the newest few and the
+// waterfall shows them all.
+static const uint32_t HistorySize = 200;
+static const uint32_t SpectrumScans = 10;
+static const int GridBins = 1024;
+// Each pane redraws at most this often, independent of the scan rate.
+static const int SpectrumMilliSeconds = 30;
+static const int WaterfallMilliSeconds = 100;
+static const int TimeSeriesMilliSeconds = 250;
+// Waterfall cells with no scan, or no input in their bin.
+static const double WaterfallEmpty = -100.0;
+// The time series pane shows this many seconds up to the newest scan.
+static const time_t TimeSeriesWindow = 6 * 3600;
+
+MainWindow::MainWindow(ScanSource * dataReader,
+                       uint32_t delayMilliSeconds,
+                       bool showWaterfall,
+                       double trackLowFrequency,
+                       double trackHighFrequency,
+                       uint32_t trackScans,
+                       QWidget * parent) :
   QMainWindow(parent),
   ui(new Ui::MainWindow),
-  m_inputFile(inputFile),
+  m_dataReader(dataReader),
   m_delayMilliSeconds(delayMilliSeconds),
-  m_buffer(10)
+  m_waterfallPlot(NULL),
+  m_waterfallMap(NULL),
+  m_timeSeriesPlot(NULL),
+  m_pipeline(dataReader, HistorySize, GridBins),
+  m_timeSeriesScans(0),
+  m_showWaterfall(showWaterfall),
+  m_trackLowFrequency(trackLowFrequency),
+  m_trackHighFrequency(trackHighFrequency)
 {
+  if (trackLowFrequency > 0) {
+    this->m_pipeline.EnableBinStore(trackScans);
+  }
   ui->setupUi(this);
   setGeometry(400, 250, 840, 480); // (.., .., width, height)
   
@@ -66,30 +103,89 @@ MainWindow::MainWindow(const char * inputFile, uint32_t delayMilliSeconds, QWidg
 
 void MainWindow::setupDemo()
 {
+  // One decode stage feeds every pane; each pane renders on its own timer.
+  connect(&dataTimer, SIGNAL(timeout()), this, SLOT(decodeNextScan()));
+  dataTimer.start(this->m_delayMilliSeconds); // Interval 0 means to decode as fast as possible
+
   setupSpectrumDemo(ui->customPlot);
+  if (this->m_showWaterfall) {
+    this->m_waterfallPlot = new QCustomPlot(ui->centralWidget);
+    ui->verticalLayout->addWidget(this->m_waterfallPlot);
+    setupWaterfallDemo(this->m_waterfallPlot);
+  }
+  if (this->m_trackLowFrequency > 0) {
+    this->m_timeSeriesPlot = new QCustomPlot(ui->centralWidget);
+    ui->verticalLayout->addWidget(this->m_timeSeriesPlot);
+    setupTimeSeriesDemo(this->m_timeSeriesPlot);
+  }
   setWindowTitle("QCustomPlot: "+demoName);
   statusBar()->clearMessage();
   ui->customPlot->replot();
 }
 
-void MainWindow::addNextScan()
+void MainWindow::decodeNextScan()
 {
-  Buffer * inBuffer = NULL;
-  if (this->m_dataReader->GetNext(inBuffer) == 0) {
-    for (uint32_t i = 0; i < inBuffer->size(); i++) {
-      this->m_buffer.appendPoint(inBuffer->m_frequencyBuffer[i], inBuffer->m_powerBuffer[i]);
+  QElapsedTimer elapsed;
+  elapsed.start();
+  uint64_t scanCount = this->m_pipeline.GetScanCount();
+  int status;
+  while ((status = this->m_pipeline.Poll()) == 0) {
+    if (this->m_delayMilliSeconds != 0 || elapsed.elapsed() >= DecodeBudgetMilliSeconds) {
+      break;
     }
-  } else {
+  }
+  uint64_t decoded = this->m_pipeline.GetScanCount() - scanCount;
+  this->m_scanCount += decoded;
+  if (status < 0) {
     dataTimer.stop();
-    double milliSeconds = QDateTime::currentDateTime().toMSecsSinceEpoch();
-    ui->statusBar->showMessage(
-          QString("Done: %1 --> %2 scans/sec, Total scans: %3")
-          .arg(QString(this->m_timeBuffer))
-          .arg(this->m_scanCount*1000/(milliSeconds - this->m_startMilliSeconds), 0, 'f', 0)
-          .arg(this->m_nextScanIndex)
-          , 0);
     return;
   }
+  // A live source with nothing new is polled every IdleMilliSeconds
+  // rather than spinning; the set delay resumes as soon as scans arrive.
+  uint32_t interval = this->m_delayMilliSeconds;
+  if (status > 0 && decoded == 0) {
+    interval = std::max(interval, IdleMilliSeconds);
+  }
+  if (dataTimer.interval() != int(interval)) {
+    dataTimer.setInterval(interval);
+  }
+}
+
+// Scans each pane skipped because it fell more than the pipeline history
+// behind the decoder, and scans a live source lost before they were
+// decoded.  The time series reads the bin store, which keeps every scan,
+// so it never drops any.
+QString MainWindow::droppedMessage()
+{
+  QString message = QString(", Dropped: spectrum %1").arg(this->m_spectrumSubscription.m_droppedCount);
+  if (this->m_waterfallMap != NULL) {
+    message += QString(" waterfall %1").arg(this->m_waterfallSubscription.m_droppedCount);
+  }
+  uint64_t overruns = this->m_dataReader->GetOverrunCount();
+  if (overruns != 0) {
+    message += QString(", Overruns: %1").arg(overruns);
+  }
+  return message;
+}
+
+void MainWindow::addNextScan()
+{
+  std::vector<ScanPtr> scans;
+  if (this->m_pipeline.GetNewScans(this->m_spectrumSubscription, scans) == 0) {
+    if (this->m_pipeline.IsDone()) {
+      spectrumTimer.stop();
+      double milliSeconds = QDateTime::currentDateTime().toMSecsSinceEpoch();
+      ui->statusBar->showMessage(
+            QString("Done: %1 --> %2 scans/sec, Total scans: %3")
+            .arg(QString(this->m_timeBuffer))
+            .arg(this->m_scanCount*1000/(milliSeconds - this->m_startMilliSeconds), 0, 'f', 0)
+            .arg(this->m_pipeline.GetScanCount())
+            + this->droppedMessage()
+            , 0);
+    }
+    return;
+  }
+  this->m_pipeline.GetHistory(SpectrumScans, scans);
 
   ui->customPlot->graph()->clearData();
   double lowerFrequency = std::numeric_limits<double>::max();
@@ -97,44 +193,42 @@ void MainWindow::addNextScan()
   double lowerPower = std::numeric_limits<double>::max();
   double upperPower = std::numeric_limits<double>::min();
   int alpha = 27;
-  for (CircularBuffer::BufferType * buffer : this->m_buffer.getBuffers()) {
-    for (uint32_t i = 0; i < buffer->size(); i++) {
+  for (const ScanPtr & scan : scans) {
+    for (uint32_t i = 0; i < scan->m_frequency.size(); i++) {
 #if 0
       QPen pen;
       pen.setColor(QColor(0, 200, 0, alpha));
       ui->customPlot->graph()->setPen(pen);
 #endif
-      ui->customPlot->graph()->addData((*buffer)[i].first, (*buffer)[i].second);
-      lowerFrequency = std::min<double>(lowerFrequency, (*buffer)[i].first);
-      upperFrequency = std::max<double>(upperFrequency, (*buffer)[i].first);
-      lowerPower = std::min<double>(lowerPower, (*buffer)[i].second);
-      upperPower = std::max<double>(upperPower, (*buffer)[i].second);
+      ui->customPlot->graph()->addData(scan->m_frequency[i], scan->m_power[i]);
+      lowerFrequency = std::min<double>(lowerFrequency, scan->m_frequency[i]);
+      upperFrequency = std::max<double>(upperFrequency, scan->m_frequency[i]);
+      lowerPower = std::min<double>(lowerPower, scan->m_power[i]);
+      upperPower = std::max<double>(upperPower, scan->m_power[i]);
     }
     alpha += 23;
   }
 
   ui->customPlot->xAxis->setRange(lowerFrequency - 50e6, upperFrequency + 50e6);
   ui->customPlot->yAxis->setRange(lowerPower - 0.1, upperPower + 0.3);
-  bool expandOnly = this->m_nextScanIndex % 100 != 0;
+  bool expandOnly = this->m_pipeline.GetScanCount() % 100 != 0;
   ui->customPlot->graph()->rescaleAxes(expandOnly);
   ui->customPlot->replot();
   double milliSeconds = QDateTime::currentDateTime().toMSecsSinceEpoch();
-  this->m_scanCount++;
   if (milliSeconds - this->m_startMilliSeconds > 1000) {
-    DataReader::TimeToString(inBuffer->m_time, 
+    DataReader::TimeToString(scans.back()->m_time, 
                              this->m_timeBuffer, 
                              std::extent<decltype(this->m_timeBuffer)>::value);
     ui->statusBar->showMessage(
           QString("%1 --> %2 scans/sec, Total scans: %3")
           .arg(QString(this->m_timeBuffer))
           .arg(this->m_scanCount*1000/(milliSeconds - this->m_startMilliSeconds), 0, 'f', 0)
-          .arg(this->m_nextScanIndex)
+          .arg(this->m_pipeline.GetScanCount())
+          + this->droppedMessage()
           , 0);
     this->m_startMilliSeconds = milliSeconds;
     this->m_scanCount = 0;
   }
-  this->m_buffer.nextBuffer();
-  this->m_nextScanIndex++;
 }
 
 void MainWindow::setupSpectrumDemo(QCustomPlot *customPlot)
@@ -143,10 +237,6 @@ void MainWindow::setupSpectrumDemo(QCustomPlot *customPlot)
   customPlot->legend->setVisible(true);
   customPlot->legend->setFont(QFont("Helvetica", 9));
 
-  // Open the input file and create a reader.
-  this->m_dataReader = new DataReader(this->m_inputFile);
-  this->m_nextScanIndex = 0;
-
   QPen pen;
   //QStringList lineNames;
   // lineNames << "lsNone" << "lsLine" << "lsStepLeft" << "lsStepRight" << "lsStepCenter" << "lsImpulse";
@@ -161,6 +251,8 @@ void MainWindow::setupSpectrumDemo(QCustomPlot *customPlot)
   // generate data:
   this->m_startMilliSeconds = QDateTime::currentDateTime().toMSecsSinceEpoch();
   this->m_scanCount = 0;
+  this->m_timeBuffer[0] = '\0';
+  this->decodeNextScan();
   this->addNextScan();
   // zoom out a bit:
   // ui->customPlot->yAxis->scaleRange(1.1, ui->customPlot->yAxis->range().center());
@@ -173,55 +265,134 @@ void MainWindow::setupSpectrumDemo(QCustomPlot *customPlot)
   // make top right axes clones of bottom left axes:
   customPlot->axisRect()->setupFullAxesBox();
 
-  // setup a timer that repeatedly calls MainWindow::realtimeDataSlot:
-  connect(&dataTimer, SIGNAL(timeout()), this, SLOT(addNextScan()));
-  dataTimer.start(this->m_delayMilliSeconds); // Interval 0 means to refresh as fast as possible
+  // setup a timer that repeatedly calls MainWindow::addNextScan:
+  connect(&spectrumTimer, SIGNAL(timeout()), this, SLOT(addNextScan()));
+  spectrumTimer.start(SpectrumMilliSeconds);
 }
 
-void MainWindow::setupPlayground(QCustomPlot *customPlot)
+void MainWindow::renderWaterfall()
 {
-  Q_UNUSED(customPlot)
+  std::vector<ScanPtr> scans;
+  if (this->m_pipeline.GetNewScans(this->m_waterfallSubscription, scans) == 0) {
+    return;
+  }
+
+  // Newest scan on top.  Rows come from the pipeline cache, so only scans
+  // no pane has asked for yet are binned.
+  uint32_t count = this->m_pipeline.GetHistory(HistorySize, scans);
+  QCPColorMapData * data = this->m_waterfallMap->data();
+  data->setKeyRange(QCPRange(this->m_pipeline.GetStartFrequency(),
+                             this->m_pipeline.GetBinFrequency(GridBins - 1)));
+  for (uint32_t y = 0; y < count; y++) {
+    RowPtr row = this->m_pipeline.GetRow(scans[y]);
+    if (!row) {
+      continue;
+    }
+    int rowIndex = HistorySize - count + y;
+    for (int x = 0; x < GridBins; x++) {
+      float power = (*row)[x];
+      data->setCell(x, rowIndex, std::isnan(power) ? WaterfallEmpty : power);
+    }
+  }
+  this->m_waterfallMap->rescaleDataRange(true);
+  this->m_waterfallPlot->rescaleAxes();
+  this->m_waterfallPlot->replot();
 }
 
-MainWindow::~MainWindow()
+void MainWindow::setupWaterfallDemo(QCustomPlot *customPlot)
 {
-  delete ui;
+  demoName += " + Waterfall";
+  customPlot->axisRect()->setupFullAxesBox(true);
+  customPlot->xAxis->setLabel("Frequency");
+  customPlot->yAxis->setLabel("Scan");
+  this->m_waterfallMap = new QCPColorMap(customPlot->xAxis, customPlot->yAxis);
+  customPlot->addPlottable(this->m_waterfallMap);
+  this->m_waterfallMap->data()->setSize(GridBins, HistorySize);
+  this->m_waterfallMap->data()->setRange(QCPRange(0, GridBins - 1), QCPRange(0, HistorySize - 1));
+  this->m_waterfallMap->data()->fill(WaterfallEmpty);
+  this->m_waterfallMap->setGradient(QCPColorGradient::gpJet);
+
+  connect(&waterfallTimer, SIGNAL(timeout()), this, SLOT(renderWaterfall()));
+  waterfallTimer.start(WaterfallMilliSeconds);
 }
 
+void MainWindow::renderTimeSeries()
+{
+  BinStore * binStore = this->m_pipeline.GetBinStore();
+  if (binStore == NULL || this->m_pipeline.GetScanCount() == this->m_timeSeriesScans) {
+    return;
+  }
+  this->m_timeSeriesScans = this->m_pipeline.GetScanCount();
+  // Only the tracked bins' columns are read, however many scans the store
+  // holds.
+  time_t latest = binStore->GetLatestTime();
+  BinSeries series;
+  bool found;
+  if (this->m_trackHighFrequency > this->m_trackLowFrequency) {
+    found = binStore->GetBandSeries(this->m_trackLowFrequency,
+                                    this->m_trackHighFrequency,
+                                    latest - TimeSeriesWindow,
+                                    latest,
+                                    this->m_bandPower,
+                                    series);
+  } else {
+    found = binStore->GetSeries(this->m_trackLowFrequency, latest - TimeSeriesWindow, latest, series);
+  }
+  if (!found) {
+    QString message = QString("Tracked frequency is outside the scanned range %1 - %2 MHz")
+      .arg(binStore->GetBinFrequency(0) / 1e6)
+      .arg(binStore->GetBinFrequency(GridBins - 1) / 1e6);
+    fprintf(stderr, "%s\n", message.toLatin1().data());
+    this->m_timeSeriesPlot->graph()->setName(message);
+    this->m_timeSeriesPlot->replot();
+    timeSeriesTimer.stop();
+    this->m_pipeline.DisableBinStore();
+    return;
+  }
+  // Bins no input fell in are NaN; leave them out.
+  QVector<double> keys;
+  QVector<double> values;
+  keys.reserve(series.m_size);
+  values.reserve(series.m_size);
+  for (uint32_t i = 0; i < series.m_size; i++) {
+    if (!std::isnan(series.m_power[i])) {
+      keys.push_back(series.m_time[i]);
+      values.push_back(series.m_power[i]);
+    }
+  }
+  this->m_timeSeriesPlot->graph()->setData(keys, values);
+  this->m_timeSeriesPlot->graph()->rescaleAxes();
+  this->m_timeSeriesPlot->replot();
+}
 
+void MainWindow::setupTimeSeriesDemo(QCustomPlot *customPlot)
+{
+  demoName += " + Time Series";
+  customPlot->addGraph();
+  customPlot->graph()->setPen(QPen(QColor(0, 0, 200)));
+  if (this->m_trackHighFrequency > this->m_trackLowFrequency) {
+    customPlot->graph()->setName(QString("Peak power %1 - %2 MHz")
+                                 .arg(this->m_trackLowFrequency / 1e6)
+                                 .arg(this->m_trackHighFrequency / 1e6));
+  } else {
+    customPlot->graph()->setName(QString("Power at %1 MHz").arg(this->m_trackLowFrequency / 1e6));
+  }
+  customPlot->legend->setVisible(true);
+  customPlot->legend->setFont(QFont("Helvetica", 9));
+  customPlot->xAxis->setTickLabelType(QCPAxis::ltDateTime);
+  customPlot->xAxis->setDateTimeFormat("hh:mm:ss");
+  customPlot->axisRect()->setupFullAxesBox();
 
+  connect(&timeSeriesTimer, SIGNAL(timeout()), this, SLOT(renderTimeSeries()));
+  timeSeriesTimer.start(TimeSeriesMilliSeconds);
+}
 
+void MainWindow::setupPlayground(QCustomPlot *customPlot)
+{
+  Q_UNUSED(customPlot)
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+MainWindow::~MainWindow()
+{
+  delete ui;
+}
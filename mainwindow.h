@@ -45,8 +45,8 @@
 #include <QMainWindow>
 #include <QTimer>
 #include "../../Qt/qcustomplot/qcustomplot.h" // the header file of QCustomPlot. Don't forget to add it to your project, if you use an IDE, so it gets compiled.
-#include "buffer.h"
 #include "reader.h"
+#include "scanpipeline.h"
 
 namespace Ui {
 class MainWindow;
@@ -57,26 +57,50 @@ class MainWindow : public QMainWindow
   Q_OBJECT
   
 public:
-  explicit MainWindow(const char * inputFile, uint32_t delayMilliSeconds, QWidget *parent = 0);
+  explicit MainWindow(ScanSource * dataReader,
+                      uint32_t delayMilliSeconds,
+                      bool showWaterfall,
+                      double trackLowFrequency,
+                      double trackHighFrequency,
+                      uint32_t trackScans,
+                      QWidget *parent = 0);
   ~MainWindow();
 
   void setupDemo();
   void setupSpectrumDemo(QCustomPlot * customPlot);
+  void setupWaterfallDemo(QCustomPlot * customPlot);
+  void setupTimeSeriesDemo(QCustomPlot * customPlot);
   void setupPlayground(QCustomPlot * customPlot);
 
 private slots:
+  void decodeNextScan();
   void addNextScan();
+  void renderWaterfall();
+  void renderTimeSeries();
 
 private:
+  QString droppedMessage();
+
   Ui::MainWindow *ui;
   QString demoName;
   QTimer dataTimer;
+  QTimer spectrumTimer;
+  QTimer waterfallTimer;
+  QTimer timeSeriesTimer;
   QCPItemTracer *itemDemoPhaseTracer;
-  const char * m_inputFile;
+  ScanSource * m_dataReader;
   uint32_t m_delayMilliSeconds;
-  CircularBuffer m_buffer;
-  DataReader * m_dataReader;
-  uint32_t m_nextScanIndex;
+  QCustomPlot * m_waterfallPlot;
+  QCPColorMap * m_waterfallMap;
+  QCustomPlot * m_timeSeriesPlot;
+  ScanPipeline m_pipeline;
+  ScanSubscription m_spectrumSubscription;
+  ScanSubscription m_waterfallSubscription;
+  uint64_t m_timeSeriesScans;
+  std::vector<float> m_bandPower;
+  bool m_showWaterfall;
+  double m_trackLowFrequency;
+  double m_trackHighFrequency;
   double m_startMilliSeconds;
   uint32_t m_scanCount;
   char m_timeBuffer[128];
@@ -9,12 +9,33 @@
 Buffer::Buffer(uint32_t capacity)
   : m_capacity(capacity),
     m_time(0),
-    m_size(0)
+    m_size(0),
+    m_ownsStorage(true)
 {
   this->m_frequencyBuffer = new float[capacity];
   this->m_powerBuffer = new float[capacity];
 }
 
+// Wrap storage owned by someone else, e.g. a slot of a shared-memory ring.
+// A later AddData past the wrapped size copies into private storage.
+Buffer::Buffer(float * frequencyBuffer, float * powerBuffer, uint32_t size)
+  : m_frequencyBuffer(frequencyBuffer),
+    m_powerBuffer(powerBuffer),
+    m_capacity(size),
+    m_time(0),
+    m_size(size),
+    m_ownsStorage(false)
+{
+}
+
+Buffer::~Buffer()
+{
+  if (this->m_ownsStorage) {
+    delete [] this->m_frequencyBuffer;
+    delete [] this->m_powerBuffer;
+  }
+}
+
 bool Buffer::Resize(uint32_t capacity)
 {
   if (capacity > this->m_capacity) {
@@ -22,6 +43,11 @@ bool Buffer::Resize(uint32_t capacity)
     float * tmp_power = new float[capacity];
     memcpy(tmp_frequency, this->m_frequencyBuffer, this->m_capacity * sizeof(float));
     memcpy(tmp_power, this->m_powerBuffer, this->m_capacity * sizeof(float));
+    if (this->m_ownsStorage) {
+      delete [] this->m_frequencyBuffer;
+      delete [] this->m_powerBuffer;
+    }
+    this->m_ownsStorage = true;
     this->m_frequencyBuffer = tmp_frequency;
     this->m_powerBuffer = tmp_power;
     this->m_capacity = capacity;
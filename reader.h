@@ -14,7 +14,12 @@ struct Buffer
   uint32_t m_capacity;
   time_t m_time;
   uint32_t m_size;
+  bool m_ownsStorage;
   Buffer(uint32_t capacity);
+  Buffer(float * frequencyBuffer, float * powerBuffer, uint32_t size);
+  ~Buffer();
+  Buffer(const Buffer &) = delete;
+  Buffer & operator=(const Buffer &) = delete;
   bool Resize(uint32_t capacity);
   bool AddData(float frequency, float power);
   uint32_t size() {
@@ -25,7 +30,27 @@ struct Buffer
   }
 };
 
-class DataReader
+// Anything that produces a sequence of scans for display.  GetNext
+// returns 0 with a scan, 1 when no scan is available yet and -1 once the
+// source is exhausted.  A caller that is finished with the buffer before
+// the next GetNext may call Release, which returns false if the buffer
+// changed while it was in use.  GetOverrunCount counts the times a live
+// source dropped or overwrote scans because its reader fell behind.
+class ScanSource
+{
+ public:
+  virtual ~ScanSource() {}
+  virtual int GetNext(Buffer * & buffer) = 0;
+  virtual bool IsDone() = 0;
+  virtual bool Release() {
+    return true;
+  }
+  virtual uint64_t GetOverrunCount() {
+    return 0;
+  }
+};
+
+class DataReader : public ScanSource
 {
   const char * m_fileName;
   FILE * m_inputFile;
@@ -38,8 +63,8 @@ class DataReader
   DataReader(const char * fileName);
   DataReader(FILE * file);
   void Initialize(FILE * file);
-  int GetNext(Buffer * & buffer);
-  bool IsDone() {
+  int GetNext(Buffer * & buffer) override;
+  bool IsDone() override {
     return this->m_done;
   }
   bool Reset() {
@@ -0,0 +1,140 @@
+#include <assert.h>
+#include <algorithm>
+#include "scanpipeline.h"
+
+Scan::Scan(uint64_t sequence, Buffer * buffer)
+  : m_sequence(sequence),
+    m_time(buffer->m_time),
+    m_frequency(buffer->m_frequencyBuffer, buffer->m_frequencyBuffer + buffer->size()),
+    m_power(buffer->m_powerBuffer, buffer->m_powerBuffer + buffer->size())
+{
+}
+
+ScanPipeline::ScanPipeline(ScanSource * source, uint32_t historySize, int binCount)
+  : m_source(source),
+    m_historySize(historySize),
+    m_nextSequence(0),
+    m_binCount(binCount),
+    m_startFrequency(0),
+    m_stopFrequency(0),
+    m_hasGrid(false),
+    m_binStoreScans(0),
+    m_done(false)
+{
+  assert(historySize > 0 && binCount > 1);
+}
+
+// The grid is fitted to the first scan that has a span.
+void ScanPipeline::SetGrid(const Scan & scan)
+{
+  if (!FitGrid(scan.m_frequency.data(),
+               scan.m_frequency.size(),
+               this->m_binCount,
+               this->m_startFrequency,
+               this->m_stopFrequency)) {
+    return;
+  }
+  this->m_hasGrid = true;
+  if (this->m_binStoreScans != 0) {
+    this->m_binStore.reset(new BinStore(this->m_startFrequency,
+                                        this->m_stopFrequency,
+                                        this->m_binCount,
+                                        this->m_binStoreScans));
+  }
+}
+
+// Decode the next scan from the source, returning its GetNext status.  A
+// scan overwritten while it was copied is dropped but still returns 0, as
+// more may be ready.
+int ScanPipeline::Poll()
+{
+  if (this->m_done) {
+    return -1;
+  }
+  Buffer * buffer = NULL;
+  int status = this->m_source->GetNext(buffer);
+  if (status != 0) {
+    this->m_done = status < 0;
+    return status;
+  }
+  ScanPtr scan = std::make_shared<const Scan>(this->m_nextSequence, buffer);
+  if (!this->m_source->Release()) {
+    // Overwritten while being copied; the source has reported it.
+    return 0;
+  }
+  this->m_nextSequence++;
+  if (!this->m_hasGrid) {
+    this->SetGrid(*scan);
+  }
+  this->m_history.push_back(scan);
+  this->m_rows.push_back(RowPtr());
+  if (this->m_history.size() > this->m_historySize) {
+    this->m_history.pop_front();
+    this->m_rows.pop_front();
+  }
+  if (this->m_binStore) {
+    RowPtr row = this->GetRow(scan);
+    if (!row) {
+      return 0;
+    }
+    this->m_binStore->AppendScan(scan->m_time, row->data());
+  }
+  return 0;
+}
+
+ScanPtr ScanPipeline::GetLatest()
+{
+  return this->m_history.empty() ? ScanPtr() : this->m_history.back();
+}
+
+// The newest count scans, oldest first.
+uint32_t ScanPipeline::GetHistory(uint32_t count, std::vector<ScanPtr> & scans)
+{
+  count = std::min<uint32_t>(count, this->m_history.size());
+  scans.assign(this->m_history.end() - count, this->m_history.end());
+  return count;
+}
+
+// Scans decoded since the subscription last looked.  Scans that already
+// left the history are counted as dropped.
+uint32_t ScanPipeline::GetNewScans(ScanSubscription & subscription, std::vector<ScanPtr> & scans)
+{
+  scans.clear();
+  if (this->m_history.empty()) {
+    return 0;
+  }
+  uint64_t oldest = this->m_history.front()->m_sequence;
+  if (subscription.m_nextSequence < oldest) {
+    subscription.m_droppedCount += oldest - subscription.m_nextSequence;
+    subscription.m_nextSequence = oldest;
+  }
+  scans.assign(this->m_history.begin() + (subscription.m_nextSequence - oldest), this->m_history.end());
+  subscription.m_nextSequence = this->m_nextSequence;
+  return scans.size();
+}
+
+// The scan binned onto the pipeline grid.  Rows are built once and
+// shared by every view; a scan no longer in the history gets a null row.
+RowPtr ScanPipeline::GetRow(const ScanPtr & scan)
+{
+  if (this->m_history.empty() || !this->m_hasGrid) {
+    return RowPtr();
+  }
+  uint64_t oldest = this->m_history.front()->m_sequence;
+  if (scan->m_sequence < oldest || scan->m_sequence >= this->m_nextSequence) {
+    return RowPtr();
+  }
+  RowPtr & row = this->m_rows[scan->m_sequence - oldest];
+  if (!row) {
+    std::shared_ptr<std::vector<float>> newRow = std::make_shared<std::vector<float>>(this->m_binCount);
+    BinPeakPower(scan->m_frequency.data(),
+                 scan->m_power.data(),
+                 scan->m_frequency.size(),
+                 this->m_startFrequency,
+                 this->m_stopFrequency,
+                 newRow->data(),
+                 this->m_binCount);
+    row = newRow;
+  }
+  return row;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <time.h>
+#include <stdint.h>
+#include "reader.h"
+#include "binstore.h"
+
+// One decoded scan.  Scans are shared read-only between every view, so
+// they are handed out as ref-counted const pointers.  The bins are copied
+// out of the source's buffer: for a shared-memory ring that gives up the
+// zero-copy hand-off, one memcpy per scan, in exchange for views that can
+// hold scans as long as they like without the writer overwriting them.
+struct Scan
+{
+  uint64_t m_sequence;
+  time_t m_time;
+  std::vector<float> m_frequency;
+  std::vector<float> m_power;
+  Scan(uint64_t sequence, Buffer * buffer);
+};
+
+typedef std::shared_ptr<const Scan> ScanPtr;
+typedef std::shared_ptr<const std::vector<float>> RowPtr;
+
+// A view's position in the pipeline.  Each view keeps its own so it can
+// consume scans at its own rate.
+struct ScanSubscription
+{
+  uint64_t m_nextSequence;
+  uint64_t m_droppedCount;
+  ScanSubscription()
+    : m_nextSequence(0),
+      m_droppedCount(0)
+  {
+  }
+};
+
+// Decodes scans from a ScanSource once and fans them out to any number of
+// views.  The last historySize scans are kept along with their rows binned
+// onto a common grid by BinPeakPower, built the first time any view asks,
+// so adding a view does not add any parsing or binning.  With the bin
+// store enabled every decoded row is also appended to a BinStore for time
+// series that reach back further than the history.
+class ScanPipeline
+{
+  ScanSource * m_source;
+  uint32_t m_historySize;
+  std::deque<ScanPtr> m_history;
+  std::deque<RowPtr> m_rows;
+  uint64_t m_nextSequence;
+  int m_binCount;
+  double m_startFrequency;
+  double m_stopFrequency;
+  bool m_hasGrid;
+  uint32_t m_binStoreScans;
+  std::unique_ptr<BinStore> m_binStore;
+  bool m_done;
+ private:
+  void SetGrid(const Scan & scan);
+ public:
+  ScanPipeline(ScanSource * source, uint32_t historySize, int binCount);
+  int Poll();
+  // Keep the latest retainScans rows in a BinStore; see BinStore.
+  void EnableBinStore(uint32_t retainScans) {
+    this->m_binStoreScans = retainScans;
+  }
+  void DisableBinStore() {
+    this->m_binStoreScans = 0;
+    this->m_binStore.reset();
+  }
+  // NULL until the first scan has fixed the grid.
+  BinStore * GetBinStore() {
+    return this->m_binStore.get();
+  }
+  bool IsDone() {
+    return this->m_done;
+  }
+  uint64_t GetScanCount() {
+    return this->m_nextSequence;
+  }
+  ScanPtr GetLatest();
+  uint32_t GetHistory(uint32_t count, std::vector<ScanPtr> & scans);
+  uint32_t GetNewScans(ScanSubscription & subscription, std::vector<ScanPtr> & scans);
+  RowPtr GetRow(const ScanPtr & scan);
+  int GetBinCount() {
+    return this->m_binCount;
+  }
+  double GetStartFrequency() {
+    return this->m_startFrequency;
+  }
+  double GetStopFrequency() {
+    return this->m_stopFrequency;
+  }
+  double GetBinFrequency(int bin) {
+    return this->m_startFrequency + bin * (this->m_stopFrequency - this->m_startFrequency) / this->m_binCount;
+  }
+};
@@ -0,0 +1,370 @@
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <new>
+#include <algorithm>
+#include "shmreader.h"
+
+static uint64_t SlotStride(uint32_t slotCapacity)
+{
+  // Keep every slot on its own cache lines.
+  uint64_t stride = sizeof(ShmRingSlot) + 2 * uint64_t(slotCapacity) * sizeof(float);
+  return (stride + 63) & ~uint64_t(63);
+}
+
+static uint64_t HeaderSize()
+{
+  return (sizeof(ShmRingHeader) + 63) & ~uint64_t(63);
+}
+
+// How often an idle reader looks for a ring that is missing or replaced.
+static const uint64_t AttachCheckMilliSeconds = 250;
+
+// Overruns come in bursts; log them at most this often.
+static const uint64_t OverrunLogMilliSeconds = 1000;
+
+static uint64_t MonotonicMilliSeconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool IsValidHeader(ShmRingHeader * header, size_t mappedSize)
+{
+  return header->m_magic.load(std::memory_order_acquire) == ShmRingMagic &&
+    header->m_version == ShmRingVersion &&
+    header->m_slotCount != 0 &&
+    header->m_slotStride == SlotStride(header->m_slotCapacity) &&
+    HeaderSize() + header->m_slotCount * header->m_slotStride <= mappedSize;
+}
+
+ShmRingReader::ShmRingReader(const char * name)
+  : m_name(name),
+    m_base(NULL),
+    m_mappedSize(0),
+    m_header(NULL),
+    m_epoch(0),
+    m_buffer(NULL, NULL, 0),
+    m_readSequence(0),
+    m_handedOut(false),
+    m_overrunCount(0),
+    m_droppedCount(0),
+    m_loggedOverrunCount(0),
+    m_loggedDroppedCount(0),
+    m_nextOverrunLog(0),
+    m_nextAttachCheck(0),
+    m_waiting(false),
+    m_done(false)
+{
+  this->Attach();
+}
+
+ShmRingReader::~ShmRingReader()
+{
+  this->LogOverruns();
+  this->Detach();
+}
+
+// Map the ring if a writer has finished creating it.  Returns false, and
+// leaves the reader detached, if there is no usable ring yet.
+bool ShmRingReader::Attach()
+{
+  this->m_nextAttachCheck = MonotonicMilliSeconds() + AttachCheckMilliSeconds;
+  int fd = shm_open(this->m_name, O_RDONLY, 0);
+  if (fd == -1) {
+    if (errno != ENOENT) {
+      perror("shm_open");
+    }
+  } else {
+    struct stat status;
+    if (fstat(fd, &status) == 0 && size_t(status.st_size) >= HeaderSize()) {
+      void * base = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (base == MAP_FAILED) {
+        perror("mmap");
+      } else if (!IsValidHeader(static_cast<ShmRingHeader *>(base), status.st_size)) {
+        // Not a ring, or a writer that has not published the magic yet.
+        munmap(base, status.st_size);
+      } else {
+        this->m_base = static_cast<uint8_t *>(base);
+        this->m_mappedSize = status.st_size;
+      }
+    }
+    close(fd);
+  }
+  if (this->m_base == NULL) {
+    if (!this->m_waiting) {
+      fprintf(stderr, "Waiting for ring %s...\n", this->m_name);
+      this->m_waiting = true;
+    }
+    return false;
+  }
+  this->m_waiting = false;
+  this->m_header = reinterpret_cast<ShmRingHeader *>(this->m_base);
+  this->m_epoch = this->m_header->m_epoch;
+  this->m_handedOut = false;
+  // Start with the oldest scan still held by the ring.
+  this->m_readSequence = 0;
+  uint64_t head = this->m_header->m_writeSequence.load(std::memory_order_acquire);
+  if (head >= this->m_header->m_slotCount) {
+    this->m_readSequence = head - this->m_header->m_slotCount + 1;
+  }
+  return true;
+}
+
+void ShmRingReader::Detach()
+{
+  if (this->m_base != NULL) {
+    munmap(this->m_base, this->m_mappedSize);
+    this->m_base = NULL;
+    this->m_header = NULL;
+  }
+}
+
+// True if the name now refers to a ring from a different writer.
+bool ShmRingReader::IsReset()
+{
+  this->m_nextAttachCheck = MonotonicMilliSeconds() + AttachCheckMilliSeconds;
+  int fd = shm_open(this->m_name, O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  bool reset = false;
+  struct stat status;
+  if (fstat(fd, &status) == 0 && size_t(status.st_size) >= HeaderSize()) {
+    void * base = mmap(NULL, HeaderSize(), PROT_READ, MAP_SHARED, fd, 0);
+    if (base != MAP_FAILED) {
+      ShmRingHeader * header = static_cast<ShmRingHeader *>(base);
+      reset = header->m_magic.load(std::memory_order_acquire) == ShmRingMagic &&
+        header->m_epoch != this->m_epoch;
+      munmap(base, HeaderSize());
+    }
+  }
+  close(fd);
+  return reset;
+}
+
+ShmRingSlot * ShmRingReader::GetSlot(uint64_t sequence)
+{
+  uint64_t index = sequence % this->m_header->m_slotCount;
+  return reinterpret_cast<ShmRingSlot *>(this->m_base + HeaderSize() + index * this->m_header->m_slotStride);
+}
+
+// droppedScans is zero for a scan that was overwritten while in use.
+void ShmRingReader::ReportOverrun(uint64_t droppedScans)
+{
+  this->m_overrunCount++;
+  this->m_droppedCount += droppedScans;
+  uint64_t now = MonotonicMilliSeconds();
+  if (now >= this->m_nextOverrunLog) {
+    this->LogOverruns();
+    this->m_nextOverrunLog = now + OverrunLogMilliSeconds;
+  }
+}
+
+// Log the overruns since the last time this was called, if there were any.
+void ShmRingReader::LogOverruns()
+{
+  uint64_t overruns = this->m_overrunCount - this->m_loggedOverrunCount;
+  if (overruns == 0) {
+    return;
+  }
+  fprintf(stderr, "Ring %s: %lu overruns, %lu scans dropped (%lu overruns in total)\n",
+          this->m_name,
+          (unsigned long)overruns,
+          (unsigned long)(this->m_droppedCount - this->m_loggedDroppedCount),
+          (unsigned long)this->m_overrunCount);
+  this->m_loggedOverrunCount = this->m_overrunCount;
+  this->m_loggedDroppedCount = this->m_droppedCount;
+}
+
+int ShmRingReader::GetNext(Buffer * & buffer)
+{
+  if (this->IsDone()) {
+    return -1;
+  }
+  if (this->m_base == NULL &&
+      (MonotonicMilliSeconds() < this->m_nextAttachCheck || !this->Attach())) {
+    return 1;
+  }
+  ShmRingHeader * header = this->m_header;
+
+  // The scan handed out last time was read in place; if the writer has
+  // since reused its slot the caller may have seen a torn scan.
+  this->Release();
+
+  for (;;) {
+    uint64_t head = header->m_writeSequence.load(std::memory_order_acquire);
+    if (this->m_readSequence >= head) {
+      if (header->m_closed.load(std::memory_order_acquire) &&
+          head == header->m_writeSequence.load(std::memory_order_acquire)) {
+        this->m_done = true;
+        this->LogOverruns();
+        return -1;
+      }
+      // Nothing new; a writer that died and restarted would publish
+      // into a new segment, so look for one now and then.  Overruns held
+      // back by the rate limit are logged then too.
+      if (MonotonicMilliSeconds() >= this->m_nextAttachCheck) {
+        this->LogOverruns();
+        if (this->IsReset()) {
+          fprintf(stderr, "Ring %s was reset by a new writer\n", this->m_name);
+          this->Detach();
+          this->Attach();
+        }
+      }
+      return 1;
+    }
+    // The writer fills scan head in the slot of head - slotCount, so the
+    // oldest scan that is safe to read is one newer than that.
+    if (head - this->m_readSequence >= header->m_slotCount) {
+      uint64_t oldest = head - header->m_slotCount + 1;
+      this->ReportOverrun(oldest - this->m_readSequence);
+      this->m_readSequence = oldest;
+    }
+
+    uint64_t expected = 2 * this->m_readSequence + 2;
+    ShmRingSlot * slot = this->GetSlot(this->m_readSequence);
+    if (slot->m_sequence.load(std::memory_order_acquire) != expected) {
+      // Lapped between reading the head and the slot; look again.
+      continue;
+    }
+    time_t time = slot->m_time;
+    uint32_t size = std::min(slot->m_size, header->m_slotCapacity);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->m_sequence.load(std::memory_order_relaxed) != expected) {
+      continue;
+    }
+
+    this->m_buffer.m_frequencyBuffer = slot->FrequencyBuffer();
+    this->m_buffer.m_powerBuffer = slot->PowerBuffer(header->m_slotCapacity);
+    this->m_buffer.m_capacity = size;
+    this->m_buffer.m_size = size;
+    this->m_buffer.m_time = time;
+    this->m_readSequence++;
+    this->m_handedOut = true;
+    buffer = &this->m_buffer;
+    return 0;
+  }
+}
+
+bool ShmRingReader::Release()
+{
+  if (!this->m_handedOut) {
+    return true;
+  }
+  this->m_handedOut = false;
+  uint64_t previous = this->m_readSequence - 1;
+  // Order the caller's reads of the slot before the sequence check.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint64_t sequence = this->GetSlot(previous)->m_sequence.load(std::memory_order_relaxed);
+  if (sequence != 2 * previous + 2) {
+    this->ReportOverrun(0);
+    return false;
+  }
+  return true;
+}
+
+ShmRingWriter::ShmRingWriter(const char * name, uint32_t slotCount, uint32_t slotCapacity)
+  : m_name(name),
+    m_base(NULL),
+    m_mappedSize(0),
+    m_header(NULL),
+    m_writeSequence(0),
+    m_closed(false)
+{
+  assert(slotCount > 0 && slotCapacity > 0);
+  // Never resize a segment some reader may still have mapped; replace it.
+  if (shm_unlink(name) == -1 && errno != ENOENT) {
+    perror("shm_unlink");
+    exit(-1);
+  }
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1) {
+    perror("shm_open");
+    exit(-1);
+  }
+  this->m_mappedSize = HeaderSize() + slotCount * SlotStride(slotCapacity);
+  if (ftruncate(fd, this->m_mappedSize) == -1) {
+    perror("ftruncate");
+    exit(-1);
+  }
+  void * base = mmap(NULL, this->m_mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    exit(-1);
+  }
+  this->m_base = static_cast<uint8_t *>(base);
+  memset(this->m_base, 0, this->m_mappedSize);
+  this->m_header = new (this->m_base) ShmRingHeader();
+  this->m_header->m_slotCount = slotCount;
+  this->m_header->m_slotCapacity = slotCapacity;
+  this->m_header->m_slotStride = SlotStride(slotCapacity);
+  this->m_header->m_version = ShmRingVersion;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  this->m_header->m_epoch = (uint64_t(now.tv_sec) * 1000000000 + now.tv_nsec) ^ (uint64_t(getpid()) << 48);
+  this->m_header->m_writeSequence.store(0, std::memory_order_relaxed);
+  this->m_header->m_closed.store(0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < slotCount; i++) {
+    new (this->GetSlot(i)) ShmRingSlot();
+    this->GetSlot(i)->m_sequence.store(0, std::memory_order_relaxed);
+  }
+  // Readers check the magic first, so publish it after everything else.
+  this->m_header->m_magic.store(ShmRingMagic, std::memory_order_release);
+}
+
+ShmRingWriter::~ShmRingWriter()
+{
+  if (this->m_base != NULL) {
+    this->Close();
+    munmap(this->m_base, this->m_mappedSize);
+  }
+}
+
+ShmRingSlot * ShmRingWriter::GetSlot(uint64_t sequence)
+{
+  uint64_t index = sequence % this->m_header->m_slotCount;
+  return reinterpret_cast<ShmRingSlot *>(this->m_base + HeaderSize() + index * this->m_header->m_slotStride);
+}
+
+void ShmRingWriter::Publish(time_t time, const float * frequency, const float * power, uint32_t size)
+{
+  uint32_t capacity = this->m_header->m_slotCapacity;
+  if (size > capacity) {
+    fprintf(stderr, "Scan of %u bins truncated to ring slot capacity %u\n", size, capacity);
+    size = capacity;
+  }
+  uint64_t sequence = this->m_writeSequence;
+  ShmRingSlot * slot = this->GetSlot(sequence);
+  slot->m_sequence.store(2 * sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->m_time = time;
+  slot->m_size = size;
+  memcpy(slot->FrequencyBuffer(), frequency, size * sizeof(float));
+  memcpy(slot->PowerBuffer(capacity), power, size * sizeof(float));
+  slot->m_sequence.store(2 * sequence + 2, std::memory_order_release);
+  this->m_writeSequence = sequence + 1;
+  this->m_header->m_writeSequence.store(this->m_writeSequence, std::memory_order_release);
+}
+
+// Tell readers no more scans are coming and remove the name.  Readers that
+// are attached keep their mapping until they detach.
+void ShmRingWriter::Close()
+{
+  if (this->m_closed) {
+    return;
+  }
+  this->m_header->m_closed.store(1, std::memory_order_release);
+  if (shm_unlink(this->m_name) == -1) {
+    perror("shm_unlink");
+  }
+  this->m_closed = true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <sys/types.h>
+#include "reader.h"
+
+// Layout of a POSIX shared-memory ring of binary scans.
+//
+// The segment starts with a ShmRingHeader followed by m_slotCount slots of
+// m_slotStride bytes.  Each slot is a ShmRingSlot followed by
+// m_slotCapacity frequencies and then m_slotCapacity powers, as floats.
+//
+// Scan n lives in slot n % m_slotCount.  The writer marks the slot odd
+// (2n + 1) while filling it, even (2n + 2) once it is complete, and then
+// advances m_writeSequence to n + 1.  A reader holding scan n can tell it
+// was overwritten because the slot sequence no longer reads 2n + 2.
+//
+// Every writer unlinks any old segment and creates a fresh one with a new
+// m_epoch, so a restarted writer never resizes memory a reader still has
+// mapped.  Readers notice the new epoch and attach to the new segment.
+// The writer stores m_magic last, with release ordering, so a reader that
+// loads the magic with acquire ordering sees the rest of the header.
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory ring needs lock-free 64 bit atomics");
+
+const uint32_t ShmRingMagic = 0x46505352; // "FPSR"
+const uint32_t ShmRingVersion = 2;
+
+struct ShmRingHeader
+{
+  std::atomic<uint32_t> m_magic;
+  uint32_t m_version;
+  uint32_t m_slotCount;
+  uint32_t m_slotCapacity;
+  uint64_t m_slotStride;
+  uint64_t m_epoch;
+  std::atomic<uint64_t> m_writeSequence;
+  std::atomic<uint32_t> m_closed;
+};
+
+struct ShmRingSlot
+{
+  std::atomic<uint64_t> m_sequence;
+  int64_t m_time;
+  uint32_t m_size;
+  uint32_t m_reserved;
+  float * FrequencyBuffer() {
+    return reinterpret_cast<float *>(this + 1);
+  }
+  float * PowerBuffer(uint32_t capacity) {
+    return reinterpret_cast<float *>(this + 1) + capacity;
+  }
+};
+
+// Consumes scans published to a shared-memory ring.  The Buffer handed out
+// by GetNext points straight into the ring slot; it stays valid until the
+// writer laps the reader, which is reported as an overrun.  Callers that
+// copy the scan out call Release straight after so the check covers the
+// copy rather than however long the caller takes until the next GetNext.
+// Overruns are counted as they happen but logged at most once a second.
+// Until a writer has created the ring GetNext just reports that no scan is
+// available.
+class ShmRingReader : public ScanSource
+{
+  const char * m_name;
+  uint8_t * m_base;
+  size_t m_mappedSize;
+  ShmRingHeader * m_header;
+  uint64_t m_epoch;
+  Buffer m_buffer;
+  uint64_t m_readSequence;
+  bool m_handedOut;
+  uint64_t m_overrunCount;
+  uint64_t m_droppedCount;
+  uint64_t m_loggedOverrunCount;
+  uint64_t m_loggedDroppedCount;
+  uint64_t m_nextOverrunLog;
+  uint64_t m_nextAttachCheck;
+  bool m_waiting;
+  bool m_done;
+ private:
+  bool Attach();
+  void Detach();
+  bool IsReset();
+  ShmRingSlot * GetSlot(uint64_t sequence);
+  void ReportOverrun(uint64_t droppedScans);
+  void LogOverruns();
+ public:
+  ShmRingReader(const char * name);
+  ~ShmRingReader();
+  int GetNext(Buffer * & buffer) override;
+  bool Release() override;
+  bool IsDone() override {
+    return this->m_done;
+  }
+  uint64_t GetOverrunCount() override {
+    return this->m_overrunCount;
+  }
+};
+
+// Publishes scans to a new shared-memory ring, replacing any old one of
+// the same name.  The ring is unlinked again on Close.
+class ShmRingWriter
+{
+  const char * m_name;
+  uint8_t * m_base;
+  size_t m_mappedSize;
+  ShmRingHeader * m_header;
+  uint64_t m_writeSequence;
+  bool m_closed;
+ private:
+  ShmRingSlot * GetSlot(uint64_t sequence);
+ public:
+  ShmRingWriter(const char * name, uint32_t slotCount, uint32_t slotCapacity);
+  ~ShmRingWriter();
+  void Publish(time_t time, const float * frequency, const float * power, uint32_t size);
+  void Publish(Buffer * buffer) {
+    this->Publish(buffer->m_time, buffer->m_frequencyBuffer, buffer->m_powerBuffer, buffer->size());
+  }
+  void Close();
+};
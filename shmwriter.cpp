@@ -0,0 +1,42 @@
+// Test writer for the shared-memory scan ring.  Parses a scanner text or
+// sweep CSV file and publishes each scan to the ring so fastPlot --shm can be exercised
+// without a live scanner.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "reader.h"
+#include "shmreader.h"
+#include "formatreader.h"
+
+int main(int argc, char *argv[])
+{
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <input> <shm name> [delay ms] [slots] [bins per slot]\n", argv[0]);
+    return 1;
+  }
+  const char * inputFile = argv[1];
+  const char * name = argv[2];
+  uint32_t delay = argc > 3 ? strtoul(argv[3], NULL, 10) : 0;
+  uint32_t slotCount = argc > 4 ? strtoul(argv[4], NULL, 10) : 64;
+  uint32_t slotCapacity = argc > 5 ? strtoul(argv[5], NULL, 10) : 8192;
+
+  ScanSource * reader = OpenScanReader(inputFile);
+  if (reader == NULL) {
+    return 1;
+  }
+  ShmRingWriter writer(name, slotCount, slotCapacity);
+  Buffer * buffer = NULL;
+  uint64_t scanCount = 0;
+  while (reader->GetNext(buffer) == 0) {
+    writer.Publish(buffer);
+    scanCount++;
+    if (delay != 0) {
+      usleep(delay * 1000);
+    }
+  }
+  writer.Close();
+  delete reader;
+  fprintf(stderr, "Published %lu scans to %s\n", (unsigned long)scanCount, name);
+  return 0;
+}
@@ -0,0 +1,21 @@
+#
+#  Test writer for the fastPlot shared-memory scan ring
+#
+
+TARGET = shmwriter
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS = -std=c++11
+
+SOURCES += shmwriter.cpp \
+           shmreader.cpp \
+           formatreader.cpp \
+           reader.cpp
+
+HEADERS += reader.h \
+           shmreader.h \
+           formatreader.h
+
+unix:!macx: LIBS += -lrt